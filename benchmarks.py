@@ -0,0 +1,390 @@
+'''
+Benchmark suite of the main kernels of the notebooks, runnable headless outside Jupyter.
+
+The kernels are taken from the notebooks themselves: only the imports and the definitions of the functions and classes
+of each kernel (with the definitions they use) are executed, not the cells that load data or plot. Every kernel runs
+on synthetic data of a fixed size from a fixed seed, so two runs differ only by the code and the machine.
+
+Usage:
+    python benchmarks.py run [--only PATTERN] [--repeat N] [--output PATH]
+    python benchmarks.py compare BASELINE CURRENT [--threshold 0.1] [--stat median]
+
+run writes the timings as JSON (bench_results.json by default). compare prints the ratio of the timings of two
+such files per kernel and exits with status 1 if any kernel got slower by more than the threshold.
+'''
+import argparse
+import ast
+import fnmatch
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import warnings
+from datetime import datetime
+from time import perf_counter
+
+os.environ.setdefault('MPLBACKEND', 'Agg') # the notebooks import pyplot, no display is needed
+import numpy as np
+
+REPO_DIR = os.path.dirname(os.path.abspath(__file__))
+SEED = 42
+
+BSEARCH_NB = 'Bug_analysis_binary_search_algo.ipynb'
+GRADIENT_NB = 'Calculus_Gradient_Descent_Lab.ipynb'
+GRAM_SCHMIDT_NB = 'LinAlg_Gram_Schmidt.ipynb'
+MNIST_NB = 'LinAlg_MNIST_digits_recognition.ipynb'
+
+KERNELS = {} # name of a kernel -> (setup function, parameters of the data)
+
+
+def load_defs(notebook: str, names: list[str]) -> dict:
+    '''
+    Execute the imports of a notebook and the definitions of the given functions and classes.
+
+    Parameters
+    ----------
+    notebook : str
+        Name of the notebook in the repository.
+    names : list[str]
+        Names of top-level functions and classes. The definitions they use are executed too.
+
+    Returns
+    -------
+    namespace : dict
+        Global namespace of the executed definitions.
+
+    Algorithm
+    ---------
+    Parse every code cell with ast, keep the top-level imports and definitions (a later definition overrides an
+    earlier one, as when the cells run in order), then follow the names used in the bodies of the requested
+    definitions to the other definitions of the notebook.
+    '''
+    with open(os.path.join(REPO_DIR, notebook), encoding='utf-8') as f:
+        cells = json.load(f)['cells']
+    imports, defs = [], {}
+    for cell in cells:
+        if cell['cell_type'] != 'code':
+            continue
+        # IPython magics and shell commands are not Python
+        source = ''.join(line for line in cell['source'] if not line.lstrip().startswith(('%', '!')))
+        for node in ast.parse(source).body:
+            if isinstance(node, (ast.Import, ast.ImportFrom)):
+                imports.append(node)
+            elif isinstance(node, (ast.FunctionDef, ast.ClassDef)):
+                defs[node.name] = node
+    needed, todo = set(), list(names)
+    while todo:
+        name = todo.pop()
+        if name in needed:
+            continue
+        if name not in defs:
+            raise KeyError(f'{name} is not defined in {notebook}')
+        needed.add(name)
+        todo += [node.id for node in ast.walk(defs[name]) if isinstance(node, ast.Name) and node.id in defs]
+    namespace = {'__name__': os.path.splitext(notebook)[0]}
+    for node in imports:
+        try:
+            exec(compile(ast.Module([node], type_ignores=[]), notebook, 'exec'), namespace)
+        except ImportError:
+            pass # plotting and other optional modules, a kernel that needs one fails with NameError
+    module = ast.Module([node for name, node in defs.items() if name in needed], type_ignores=[])
+    exec(compile(module, notebook, 'exec'), namespace)
+    return namespace
+
+
+def kernel(name: str, **params):
+    '''
+    Register a setup function of a kernel under a name, with the parameters of its data for the JSON output.
+    The setup function builds the data and returns a function without arguments, the only part that is timed.
+    '''
+    def register(setup: callable) -> callable:
+        KERNELS[name] = (setup, params)
+        return setup
+    return register
+
+
+# Binary search: 10000 keys, half of them absent, in a sorted list of 100000 unique integers
+def _search_data(size: int=100_000, n_keys: int=10_000) -> tuple:
+    rng = np.random.default_rng(SEED)
+    arr = np.sort(rng.choice(10 * size, size=size, replace=False))
+    keys = np.concatenate((rng.choice(arr, n_keys // 2), rng.integers(0, 10 * size, n_keys - n_keys // 2)))
+    rng.shuffle(keys)
+    return arr, keys
+
+
+def _register_bsearch(algo: str) -> None:
+    @kernel(f'bsearch/{algo}', size=100_000, n_keys=10_000)
+    def setup():
+        search = load_defs(BSEARCH_NB, [algo])[algo]
+        arr, keys = _search_data()
+        arr, keys = arr.tolist(), keys.tolist()
+        return lambda: [search(arr, key) for key in keys]
+
+
+for _algo in ('bsearch1_fixed', 'bsearch2_fixed', 'bsearch3_iterative'):
+    _register_bsearch(_algo)
+
+
+@kernel('bsearch/EytzingerSearch', size=100_000, n_keys=10_000)
+def _eytzinger():
+    searcher = load_defs(BSEARCH_NB, ['EytzingerSearch'])['EytzingerSearch']
+    arr, keys = _search_data()
+    search, keys = searcher(arr.tolist()).search, keys.tolist() # the layout is built outside of the timing
+    return lambda: [search(key) for key in keys]
+
+
+@kernel('bsearch/bsearch_batch', size=100_000, n_keys=10_000)
+def _bsearch_batch():
+    bsearch_batch = load_defs(BSEARCH_NB, ['bsearch_batch'])['bsearch_batch']
+    arr, keys = _search_data()
+    return lambda: bsearch_batch(arr, keys)
+
+
+# Gradient descent: linear regression with 100000 rows and 5 features, 200 iterations without early stop
+def _regression_data(n: int=100_000, m: int=5) -> tuple:
+    rng = np.random.default_rng(SEED)
+    X = np.concatenate((np.ones((n, 1)), rng.standard_normal((n, m))), axis=1)
+    y = X @ rng.standard_normal(m + 1) + 0.1 * rng.standard_normal(n)
+    return X, y
+
+
+@kernel('gradient/gradDescent', n=100_000, m=5, maxiter=200)
+def _grad_descent():
+    gradDescent = load_defs(GRADIENT_NB, ['gradDescent'])['gradDescent']
+    X, y = _regression_data()
+    return lambda: gradDescent(np.zeros(X.shape[1]), 0.1, X, y, maxiter=200, eps=0)
+
+
+@kernel('gradient/new_gradDescent', n=100_000, m=5, maxiter=200, a=100, b=1)
+def _new_grad_descent():
+    new_gradDescent = load_defs(GRADIENT_NB, ['new_gradDescent'])['new_gradDescent']
+    X, y = _regression_data()
+    return lambda: new_gradDescent(np.zeros(X.shape[1]), 1e-3, X, y, 100, 1, maxiter=200, eps=0)
+
+
+# Gram-Schmidt: 256 random vectors of size 512
+def _register_gram_schmidt(method: str) -> None:
+    @kernel(f'gram_schmidt/{method}', n=256, m=512)
+    def setup():
+        gram_schmidt = load_defs(GRAM_SCHMIDT_NB, ['gram_schmidt'])['gram_schmidt']
+        A = np.random.default_rng(SEED).standard_normal((256, 512))
+        return lambda: gram_schmidt(A, normalize=True, method=method)
+
+
+for _method in ('classical', 'mgs', 'householder'):
+    _register_gram_schmidt(_method)
+
+
+# SVD of the images of one digit: 784 x 6000 uint8 pixels, first 10 singular vectors
+def _register_svd(method: str) -> None:
+    @kernel(f'svd/getSingularVectorsLeft/{method}', shape=(784, 6000), k=10)
+    def setup():
+        getSingularVectorsLeft = load_defs(MNIST_NB, ['getSingularVectorsLeft'])['getSingularVectorsLeft']
+        A = np.random.default_rng(SEED).integers(0, 256, (784, 6000), dtype=np.uint8)
+        return lambda: getSingularVectorsLeft(A, k=10, method=method)
+
+
+for _method in ('economy', 'randomized', 'streaming'):
+    _register_svd(_method)
+
+
+@kernel('mnist/find_closest', n_images=500, k=10)
+def _find_closest():
+    find_closest = load_defs(MNIST_NB, ['find_closest'])['find_closest']
+    rng = np.random.default_rng(SEED)
+    bases = np.linalg.qr(rng.standard_normal((10, 784, 10)))[0] # orthonormal bases of 10 digits
+    numeric_values = np.identity(784) - bases @ np.transpose(bases, (0, 2, 1))
+    images = rng.integers(0, 256, (500, 28, 28), dtype=np.uint8)
+    return lambda: [find_closest(img, numeric_values) for img in images]
+
+
+# PCA + LinearSVC: 10 classes of 6000 flattened 28 x 28 images around random centers, 64 components
+def _digits_data(n: int=6000, dim: int=784, n_classes: int=10) -> tuple:
+    rng = np.random.default_rng(SEED)
+    centers = rng.uniform(0, 255, (n_classes, dim))
+    y = rng.integers(0, n_classes, n)
+    X = np.clip(centers[y] + 60 * rng.standard_normal((n, dim)), 0, 255).astype(np.uint8)
+    return X, y
+
+
+@kernel('pca_svc/fit', n=6000, dim=784, n_components=64)
+def _pca_svc_fit():
+    from sklearn.decomposition import PCA
+    from sklearn.pipeline import make_pipeline
+    from sklearn.preprocessing import StandardScaler
+    from sklearn.svm import LinearSVC
+    X, y = _digits_data()
+    def fit():
+        with warnings.catch_warnings(): # LinearSVC may stop at max_iter, the same amount of work each run
+            warnings.simplefilter('ignore')
+            return make_pipeline(StandardScaler(), PCA(n_components=64, random_state=SEED),
+                                 LinearSVC(random_state=SEED)).fit(X, y)
+    return fit
+
+
+@kernel('pca_svc/AffinePipeline.predict', n=6000, dim=784, n_components=64)
+def _pca_svc_predict():
+    model = _pca_svc_fit()()
+    AffinePipeline = load_defs(MNIST_NB, ['AffinePipeline'])['AffinePipeline']
+    scaler, pca, clf = (model.named_steps[step] for step in ('standardscaler', 'pca', 'linearsvc'))
+    pipeline = AffinePipeline(scaler, pca, clf)
+    X, _ = _digits_data()
+    return lambda: pipeline.predict(X)
+
+
+def time_kernel(run: callable, repeat: int=5, warmup: int=1) -> list[float]:
+    '''
+    Time a function without arguments.
+
+    Parameters
+    ----------
+    run : callable
+        Function to time.
+    repeat : int
+        Number of timed runs.
+    warmup : int
+        Number of runs before the timing, to fill the caches and load the lazily imported modules.
+
+    Returns
+    -------
+    times : list[float]
+        Time of each run in seconds.
+    '''
+    for _ in range(warmup):
+        run()
+    times = []
+    for _ in range(repeat):
+        start = perf_counter()
+        run()
+        times.append(perf_counter() - start)
+    return times
+
+
+def machine_info() -> dict:
+    '''
+    Commit, date, versions and machine of a run, as in save_results of the binary search notebook.
+    '''
+    try:
+        commit = subprocess.run(['git', 'rev-parse', '--short', 'HEAD'], capture_output=True, text=True,
+                                cwd=REPO_DIR).stdout.strip()
+    except OSError:
+        commit = ''
+    return {
+        'commit': commit or None,
+        'date': datetime.now().isoformat(timespec='seconds'),
+        'python': platform.python_version(),
+        'numpy': np.__version__,
+        'machine': platform.machine(),
+        'processor': platform.processor(),
+        'system': platform.platform(),
+        'cpu_count': os.cpu_count(),
+    }
+
+
+def run(patterns: list[str]=None, repeat: int=5, output: str='bench_results.json') -> list[dict]:
+    '''
+    Run the kernels matching any of the glob patterns (all by default) and write the results to output.
+
+    A kernel that fails, e.g. for a missing optional module, is reported with its error and the others still run.
+    '''
+    names = [name for name in KERNELS if not patterns or any(fnmatch.fnmatch(name, p) for p in patterns)]
+    results = []
+    print('-----------------------------------------+---------------+---------------')
+    print(' Kernel                                  |  Median, ms   |  Min, ms')
+    print('-----------------------------------------+---------------+---------------')
+    for name in names:
+        setup, params = KERNELS[name]
+        result = {'name': name, 'params': params, 'repeat': repeat}
+        try:
+            times = time_kernel(setup(), repeat=repeat)
+        except Exception as e:
+            result['error'] = f'{type(e).__name__}: {e}'
+            print(f' {name:39} | failed, {result["error"]}')
+        else:
+            result.update({'median_s': statistics.median(times), 'min_s': min(times), 'times_s': times})
+            print(f' {name:39} | {1e3 * result["median_s"]:13.3f} | {1e3 * result["min_s"]:13.3f}')
+        results.append(result)
+    with open(output, 'w') as f:
+        json.dump({'meta': machine_info(), 'results': results}, f, indent=1)
+    print(f'Results written to {output}')
+    return results
+
+
+def compare(baseline: str, current: str, threshold: float=0.1, stat: str='median') -> list[str]:
+    '''
+    Compare two result files of run.
+
+    Parameters
+    ----------
+    baseline : str
+        Path of the reference results.
+    current : str
+        Path of the new results.
+    threshold : float
+        Relative slowdown above which a kernel is a regression, 0.1 for 10% slower.
+    stat : str
+        'median' or 'min' of the timed runs.
+
+    Returns
+    -------
+    regressions : list[str]
+        Names of the kernels slower by more than the threshold.
+    '''
+    key = stat + '_s'
+    with open(baseline) as f:
+        base = json.load(f)
+    with open(current) as f:
+        new = json.load(f)
+    base_times = {r['name']: r[key] for r in base['results'] if key in r}
+    regressions = []
+    print(f"Baseline {base['meta'].get('commit')} ({base['meta'].get('date')}), "
+          f"current {new['meta'].get('commit')} ({new['meta'].get('date')})")
+    print('-----------------------------------------+---------------+---------------+-----------+------------')
+    print(' Kernel                                  |  Baseline, ms |  Current, ms  |  Ratio    |  Status')
+    print('-----------------------------------------+---------------+---------------+-----------+------------')
+    for r in new['results']:
+        name = r['name']
+        if key not in r or name not in base_times:
+            print(f" {name:39} | {'':13} | {'':13} | {'':9} | {'failed' if 'error' in r else 'new'}")
+            continue
+        ratio = r[key] / base_times[name]
+        if ratio > 1 + threshold:
+            status = 'REGRESSION'
+            regressions.append(name)
+        elif ratio < 1 / (1 + threshold):
+            status = 'faster'
+        else:
+            status = ''
+        print(f' {name:39} | {1e3 * base_times[name]:13.3f} | {1e3 * r[key]:13.3f} | {ratio:9.3f} | {status}')
+    print(f'{len(regressions)} regressions above {threshold:.0%}')
+    return regressions
+
+
+def main(argv: list[str]=None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest='command', required=True)
+    run_parser = commands.add_parser('run', help='run the kernels and write the timings as JSON')
+    run_parser.add_argument('--only', nargs='+', metavar='PATTERN', help='glob patterns of kernel names, e.g. svd/*')
+    run_parser.add_argument('--repeat', type=int, default=5, help='number of timed runs of each kernel')
+    run_parser.add_argument('--output', default='bench_results.json', help='path of the JSON results')
+    commands.add_parser('list', help='list the kernels')
+    compare_parser = commands.add_parser('compare', help='compare two JSON results and flag regressions')
+    compare_parser.add_argument('baseline')
+    compare_parser.add_argument('current')
+    compare_parser.add_argument('--threshold', type=float, default=0.1, help='relative slowdown of a regression')
+    compare_parser.add_argument('--stat', choices=('median', 'min'), default='median')
+    args = parser.parse_args(argv)
+    if args.command == 'list':
+        print('\n'.join(KERNELS))
+    elif args.command == 'run':
+        results = run(args.only, repeat=args.repeat, output=args.output)
+        return int(any('error' in r for r in results))
+    else:
+        return int(bool(compare(args.baseline, args.current, threshold=args.threshold, stat=args.stat)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
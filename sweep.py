@@ -0,0 +1,160 @@
+'''
+Parallel sweep runner for independent experiment configurations.
+
+Each configuration is a dict of keyword arguments of one function call, e.g. {'algo': 'bsearch1_fixed', 'size': 1000}
+or {'k': 10}. The configurations are spread across a pool of worker processes (or threads), each pinned to its own
+CPU core so that run times stay stable, and the result of every finished configuration is cached to disk,
+so an interrupted sweep resumes where it stopped.
+'''
+import hashlib
+import json
+import multiprocessing
+import os
+import pickle
+import queue
+import threading
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+_thread_state = threading.local() # core each thread of a thread pool is pinned to
+
+
+def _pin(core: int) -> None:
+    # On Linux pid 0 is the calling thread, elsewhere the workers are not pinned
+    if hasattr(os, 'sched_setaffinity'):
+        os.sched_setaffinity(0, {core})
+
+
+def _pin_worker(cores) -> None:
+    '''
+    Pin the calling worker process to the next free core from the shared queue.
+    '''
+    _pin(cores.get())
+
+
+def _thread_worker(cores, func, config):
+    # Threads of a pool are reused, so each of them is pinned only once
+    if getattr(_thread_state, 'core', None) is None:
+        _thread_state.core = cores.get()
+        _pin(_thread_state.core)
+    return func(**config)
+
+
+def _process_worker(args):
+    func, i, config = args
+    return i, func(**config)
+
+
+def config_key(func: callable, config: dict, tag: str='') -> str:
+    '''
+    Hash of a function name, its configuration and a tag, used as the name of the cache file.
+
+    Parameters
+    ----------
+    func : callable
+        Function of the sweep.
+    config : dict
+        Keyword arguments of one call, must be JSON-serializable.
+    tag : str
+        Extra string to invalidate the cache, e.g. when the function changes.
+
+    Returns
+    -------
+    key : str
+        Hex digest of the configuration.
+    '''
+    payload = json.dumps({'func': func.__qualname__, 'config': config, 'tag': tag}, sort_keys=True, default=str)
+    return hashlib.sha1(payload.encode()).hexdigest()
+
+
+def _cache_path(cache_dir: str, key: str) -> str:
+    return os.path.join(cache_dir, key + '.pkl')
+
+
+def _save(cache_dir: str, key: str, config: dict, result) -> None:
+    path = _cache_path(cache_dir, key)
+    tmp_path = path + '.tmp'
+    with open(tmp_path, 'wb') as f:
+        pickle.dump({'config': config, 'result': result}, f)
+    os.replace(tmp_path, path) # atomic, so an interrupted write never leaves a broken cache file
+
+
+def run_sweep(func: callable, configs: list[dict], cache_dir: str=None, workers: int=None, backend: str='process',
+              tag: str='', verbose: bool=True) -> list:
+    '''
+    Run func(**config) for each configuration in parallel and cache each finished result to disk.
+
+    Parameters
+    ----------
+    func : callable
+        Function to run. With the process backend it is inherited by forked workers,
+        so it can be defined in a notebook, but it cannot be a lambda or a closure.
+    configs : list[dict]
+        Keyword arguments of func, one dict per configuration. Must be JSON-serializable to be cached.
+    cache_dir : str
+        Directory of cached results, None to disable caching.
+    workers : int
+        Number of workers, by default one per available CPU core, but not more than the number of configurations.
+    backend : str
+        'process' for a pool of worker processes (for pure Python code, e.g. timings) or
+        'thread' for a pool of threads (for numpy code, which releases the GIL).
+    tag : str
+        Extra string mixed into the cache keys, change it to invalidate the cache.
+    verbose : bool
+        Whether to print the progress.
+
+    Returns
+    -------
+    results : list
+        Results of func in the same order as configs.
+    '''
+    if backend not in ('process', 'thread'):
+        raise ValueError("backend must be either 'process' or 'thread'.")
+    results = [None] * len(configs)
+    keys = [config_key(func, config, tag) for config in configs]
+    todo = [] # configurations not found in the cache
+    if cache_dir is not None:
+        os.makedirs(cache_dir, exist_ok=True)
+    for i, (config, key) in enumerate(zip(configs, keys)):
+        if cache_dir is not None and os.path.exists(_cache_path(cache_dir, key)):
+            with open(_cache_path(cache_dir, key), 'rb') as f:
+                results[i] = pickle.load(f)['result']
+        else:
+            todo.append(i)
+    if verbose:
+        print(f'{len(configs) - len(todo)} of {len(configs)} configurations found in the cache')
+    if not todo:
+        return results
+    cores = sorted(os.sched_getaffinity(0)) if hasattr(os, 'sched_getaffinity') else list(range(os.cpu_count() or 1))
+    workers = min(workers or len(cores), len(todo))
+    done = 0
+    if backend == 'process':
+        # fork keeps the functions and data defined in a notebook available in the workers
+        ctx = multiprocessing.get_context('fork' if 'fork' in multiprocessing.get_all_start_methods() else None)
+        free_cores = ctx.Queue()
+        for core in (cores * workers)[:workers]:
+            free_cores.put(core)
+        with ctx.Pool(workers, initializer=_pin_worker, initargs=(free_cores,)) as pool:
+            for i, result in pool.imap_unordered(_process_worker, [(func, i, configs[i]) for i in todo]):
+                results[i] = result
+                if cache_dir is not None:
+                    _save(cache_dir, keys[i], configs[i], result)
+                done += 1
+                if verbose:
+                    print(f'\r{done} of {len(todo)} configurations done', end='')
+    else:
+        free_cores = queue.Queue()
+        for core in (cores * workers)[:workers]:
+            free_cores.put(core)
+        with ThreadPoolExecutor(workers) as pool:
+            futures = {pool.submit(_thread_worker, free_cores, func, configs[i]): i for i in todo}
+            for future in as_completed(futures):
+                i = futures[future]
+                results[i] = future.result()
+                if cache_dir is not None:
+                    _save(cache_dir, keys[i], configs[i], results[i])
+                done += 1
+                if verbose:
+                    print(f'\r{done} of {len(todo)} configurations done', end='')
+    if verbose:
+        print()
+    return results
@@ -0,0 +1,134 @@
+'''
+Optional instrumentation of hot loops: timing spans, counters and latency histograms, exported as a Chrome trace.
+
+An instrumented function takes a tracer=None argument and guards every call to it with `if tracer is not None`,
+so with instrumentation off a loop pays one comparison per iteration and nothing is allocated. The trace is
+the JSON object format of the Chrome trace viewer, which chrome://tracing and https://ui.perfetto.dev open:
+spans are complete events ('X'), counters are counter events ('C') drawn as graphs over time.
+'''
+import json
+import os
+import threading
+from contextlib import contextmanager
+from time import perf_counter_ns
+
+
+class LatencyHistogram:
+    '''
+    Histogram of latencies in buckets of powers of two nanoseconds, [2^(b - 1), 2^b) ns in bucket b.
+
+    Adding a latency is one int.bit_length, so a histogram can be updated on every call of a hot function.
+    Quantiles are upper bounds of their buckets, i.e. exact within a factor of 2.
+    '''
+    def __init__(self) -> None:
+        self.counts = {}
+        self.n = 0
+        self.total_ns = 0
+        self.max_ns = 0
+
+    def add(self, ns: int) -> None:
+        b = ns.bit_length()
+        self.counts[b] = self.counts.get(b, 0) + 1
+        self.n += 1
+        self.total_ns += ns
+        self.max_ns = max(self.max_ns, ns)
+
+    def quantile(self, q: float) -> int:
+        '''
+        Upper bound in ns of the q-quantile of the latencies, 0 <= q <= 1.
+        '''
+        rank, seen = q * self.n, 0
+        for b in sorted(self.counts):
+            seen += self.counts[b]
+            if seen >= rank:
+                return min(2 ** b, self.max_ns)
+        return self.max_ns
+
+    def to_dict(self) -> dict:
+        return {'n': self.n, 'total_ns': self.total_ns, 'max_ns': self.max_ns,
+                'buckets_ns': {2 ** b: c for b, c in sorted(self.counts.items())}}
+
+
+class Tracer:
+    '''
+    Recorder of the spans, counters and latency histograms of one run.
+
+    Parameters
+    ----------
+    max_events : int
+        Maximal number of events kept for the trace, the later spans still update the histograms.
+    '''
+    def __init__(self, max_events: int=1_000_000) -> None:
+        self.max_events = max_events
+        self.events = []
+        self.histograms = {}
+        self.pid = os.getpid()
+        self._t0 = perf_counter_ns()
+
+    clock = staticmethod(perf_counter_ns) # start of a span, tracer.clock() in the instrumented code
+
+    def _us(self, ns: int) -> float:
+        # Chrome trace timestamps are microseconds since the start of the trace
+        return (ns - self._t0) / 1e3
+
+    def complete(self, name: str, start: int, end: int=None, **args) -> int:
+        '''
+        Record a span from start to end (by default now) in ns of tracer.clock and add its latency
+        to the histogram of the name.
+
+        Returns
+        -------
+        end : int
+            End of the span, to start the next one without reading the clock again.
+        '''
+        if end is None:
+            end = perf_counter_ns()
+        histogram = self.histograms.get(name)
+        if histogram is None:
+            histogram = self.histograms[name] = LatencyHistogram()
+        histogram.add(end - start)
+        if len(self.events) < self.max_events:
+            self.events.append({'name': name, 'ph': 'X', 'ts': self._us(start), 'dur': (end - start) / 1e3,
+                                'pid': self.pid, 'tid': threading.get_ident(), 'args': args})
+        return end
+
+    @contextmanager
+    def span(self, name: str, **args):
+        '''
+        Context manager recording its body as a span, for code outside of hot loops.
+        '''
+        start = perf_counter_ns()
+        try:
+            yield
+        finally:
+            self.complete(name, start, **args)
+
+    def counter(self, name: str, ts: int=None, **values) -> None:
+        '''
+        Record the values of counters at ts (by default now) in ns of tracer.clock, one graph per value.
+        '''
+        if len(self.events) < self.max_events:
+            self.events.append({'name': name, 'ph': 'C', 'ts': self._us(ts if ts is not None else perf_counter_ns()),
+                                'pid': self.pid, 'args': values})
+
+    def export_chrome(self, path: str) -> None:
+        '''
+        Write the events as a Chrome trace JSON file, with the histograms as extra data.
+        '''
+        directory = os.path.dirname(path)
+        if directory:
+            os.makedirs(directory, exist_ok=True)
+        with open(path, 'w') as f:
+            json.dump({'traceEvents': self.events, 'displayTimeUnit': 'ms',
+                       'otherData': {name: h.to_dict() for name, h in self.histograms.items()}}, f)
+
+    def summary(self) -> None:
+        '''
+        Print the number, total time and latency quantiles of the spans of each name.
+        '''
+        print('--------------------------------+-----------+---------------+-----------+-----------+-----------')
+        print(' Span                           |  Count    |  Total, ms    |  p50, us  |  p99, us  |  Max, us')
+        print('--------------------------------+-----------+---------------+-----------+-----------+-----------')
+        for name, h in self.histograms.items():
+            print(f' {name:30} | {h.n:9} | {h.total_ns / 1e6:13.3f} | {h.quantile(0.5) / 1e3:9.1f} | '
+                  f'{h.quantile(0.99) / 1e3:9.1f} | {h.max_ns / 1e3:9.1f}')